@@ -4,6 +4,7 @@
 #include <unordered_map>
 #include <algorithm>
 #include <string>
+#include <functional>
 using namespace std;
 
 #include "hashmap.h"
@@ -29,6 +30,31 @@ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
 FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
 IN THE SOFTWARE. */
 
+struct string_hash {
+	std::size_t operator()(const string& k) const {
+		uint32_t h = 2166136261u; // FNV-1a
+		for (char c : k) {
+			h ^= uint8_t(c);
+			h *= 16777619u;
+		}
+		return h;
+	}
+};
+
+struct string_alt_hash {
+	std::size_t operator()(const string& k) const {
+		uint32_t h = 0x9747b28c; // FNV-1a, different basis, finalized
+		for (char c : k) {
+			h ^= uint8_t(c);
+			h *= 16777619u;
+		}
+		h ^= h >> 16;
+		h *= 0x85ebca6b;
+		h ^= h >> 13;
+		return h;
+	}
+};
+
 template<class Hashmap>
 void stuff(vector<int> &v, Hashmap &basic, bool iterator_test = false, bool erase_test = false, bool at_test = false, bool find_test = false) {
 	constexpr int test = 1024 * 1024;
@@ -99,6 +125,18 @@ void stuff(vector<int> &v, Hashmap &basic, bool iterator_test = false, bool eras
 	}
 }
 
+template<class Hashmap>
+void default_stuff(vector<int> &v, Hashmap &basic) {
+	constexpr int test = 1024 * 1024;
+
+	basic.clear();
+	for (int i = 0; i < test / 2; ++i) {
+		if (basic[v[i]] != 0)
+			cout << "We cheated default value test (new key not value-initialized)." << endl;
+		basic[v[i]] = v[i] + 10;
+	}
+}
+
 template<class Hashmap>
 void time_stuff(vector<int> &v, Hashmap &h, string s) {
 	clock_t startTime;
@@ -115,6 +153,208 @@ void time_stuff(vector<int> &v, Hashmap &h, string s) {
 	cout << s << " Algo Time: " << secondsPassed << " seconds." << endl;
 }
 
+template<class Hashmap>
+void freeze_stuff(vector<int> &v, Hashmap &basic, string s) {
+	constexpr int test = 1024 * 1024;
+	clock_t startTime;
+	double secondsPassed;
+
+	basic.clear();
+	for (int i = 0; i < test / 2; ++i)
+		basic[v[i]] = v[i] + 10;
+
+	startTime = clock();
+	auto frozen = basic.freeze();
+	secondsPassed = double(clock() - startTime) / double(CLOCKS_PER_SEC);
+	cout << s << " Freeze Time: " << secondsPassed << " seconds." << endl;
+
+	if (frozen.size() != basic.size())
+		cout << "We cheated freeze size test." << endl;
+
+	startTime = clock();
+	for (int i = 0; i < test / 2; ++i) {
+		if (frozen.at(v[i]) != v[i] + 10)
+			cout << "We cheated frozen at test." << endl;
+		if (frozen.count(v[i] + 99000000) != 0)
+			cout << "We cheated frozen find test (found element not present)." << endl;
+	}
+	secondsPassed = double(clock() - startTime) / double(CLOCKS_PER_SEC);
+	cout << s << " Frozen Lookup Time: " << secondsPassed << " seconds." << endl;
+}
+
+// 28 bits of hash, so half a million keys share a thousand or so hash values
+struct narrow_hash {
+	std::size_t operator()(const int& k) const {
+		return hash_function<int>()(k) >> 4;
+	}
+};
+
+void freeze_collision_stuff(vector<int> &v) {
+	constexpr int test = 1024 * 1024;
+	lin_hashmap<int, int, narrow_hash> basic;
+	for (int i = 0; i < test / 2; ++i)
+		basic[v[i]] = v[i] + 10;
+
+	auto frozen = basic.freeze();
+	if (frozen.size() != basic.size())
+		cout << "We cheated colliding freeze size test." << endl;
+	for (int i = 0; i < test / 2; ++i) {
+		if (frozen.at(v[i]) != v[i] + 10)
+			cout << "We cheated colliding frozen at test." << endl;
+		if (frozen.count(v[i + test / 2]) != 0)
+			cout << "We cheated colliding frozen find test (found element not present)." << endl;
+	}
+}
+
+void set_stuff(vector<int> &v, int other_capacity, string s) {
+	constexpr int test = 1024 * 1024;
+	clock_t startTime;
+	double secondsPassed;
+	rh_hashmap<int, int> a(test), b(other_capacity), c(test), d(test);
+
+	for (int i = 0; i < test / 4; ++i) {
+		a[v[i]] = v[i];
+		c[v[i]] = v[i];
+		d[v[i]] = v[i];
+		b[v[i + test / 8]] = -v[i + test / 8];
+	}
+
+	startTime = clock();
+	a.merge_from(b);
+	c.intersect(b);
+	d.difference(b);
+	secondsPassed = double(clock() - startTime) / double(CLOCKS_PER_SEC);
+	cout << s << " Set Operation Time: " << secondsPassed << " seconds." << endl;
+
+	if (a.size() != test / 4 + test / 8 || c.size() != test / 8 || d.size() != test / 8)
+		cout << "We cheated set operation size test." << endl;
+	for (int i = 0; i < test / 4 + test / 8; ++i) {
+		if (a.at(v[i]) != (i < test / 4 ? v[i] : -v[i]))
+			cout << "We cheated merge test." << endl;
+		if (c.count(v[i]) != (i >= test / 8 && i < test / 4) || d.count(v[i]) != (i < test / 8))
+			cout << "We cheated intersect or difference test." << endl;
+	}
+
+	a.merge_from(a);
+	c.intersect(c);
+	d.difference(d);
+	if (a.size() != test / 4 + test / 8 || c.size() != test / 8 || !d.empty())
+		cout << "We cheated self set operation size test." << endl;
+	int total = 0;
+	for (const auto& kv : a) {
+		++total;
+		if (a.count(kv.first) != 1)
+			cout << "We cheated self merge test." << endl;
+	}
+	if (total != test / 4 + test / 8)
+		cout << "We cheated self merge iterator count test." << endl;
+}
+
+void aggregate_stuff(vector<int> &v, int rows, int groups, string s) {
+	clock_t startTime;
+	double secondsPassed;
+	vector<int32_t> keys(rows);
+	vector<int64_t> values(rows);
+	for (int i = 0; i < rows; ++i) {
+		keys[i] = v[i % v.size()] % groups;
+		values[i] = v[i % v.size()];
+	}
+	lin_hashmap<int32_t, int64_t> loop, batched;
+
+	startTime = clock();
+	for (int i = 0; i < rows; ++i)
+		loop[keys[i]] += values[i];
+	secondsPassed = double(clock() - startTime) / double(CLOCKS_PER_SEC);
+	cout << s << " Aggregate Loop Time: " << secondsPassed << " seconds." << endl;
+
+	startTime = clock();
+	batched.upsert_combine(keys.data(), values.data(), rows, plus<int64_t>());
+	secondsPassed = double(clock() - startTime) / double(CLOCKS_PER_SEC);
+	cout << s << " Aggregate Batched Time: " << secondsPassed << " seconds." << endl;
+
+	if (batched.size() != loop.size())
+		cout << "We cheated aggregate size test." << endl;
+	for (const auto& kv : loop) {
+		if (batched.at(kv.first) != kv.second)
+			cout << "We cheated aggregate sum test." << endl;
+	}
+}
+
+void cache_stuff(vector<int> &v) {
+	constexpr int test = 1024 * 1024;
+	clock_t startTime;
+	double secondsPassed;
+	clock_cache<int, int> cache(test / 8);
+	int hits = 0;
+
+	startTime = clock();
+	for (int i = 0; i < 4 * test; ++i) {
+		int k = v[i] % (test / 4);
+		auto it = cache.find(k);
+		if (it != cache.end()) {
+			++hits;
+			if (it->second != k + 10)
+				cout << "We cheated cache value test." << endl;
+		} else {
+			cache[k] = k + 10;
+		}
+		if (cache.size() > cache.capacity())
+			cout << "We cheated cache capacity test." << endl;
+	}
+	secondsPassed = double(clock() - startTime) / double(CLOCKS_PER_SEC);
+	cout << "Clock Cache Time: " << secondsPassed << " seconds, hit rate " << double(hits) / (4 * test) << "." << endl;
+
+	for (unsigned n : { 0u, (1u << 28) + 1, 0x80000001u }) {
+		try {
+			clock_cache<int, int> bad(n);
+			cout << "We cheated cache capacity check: " << n << endl;
+		} catch (const length_error&) {
+		}
+	}
+	clock_cache<int, int> one(1);
+	one[1] = 1;
+	one[2] = 2;
+	if (one.size() != 1 || one.count(2) != 1)
+		cout << "We cheated single entry cache test." << endl;
+
+	// a key used between every insert must survive a scan of cold keys
+	clock_cache<int, int> scan(test / 64);
+	scan[-1] = 0;
+	for (int i = 0; i < test; ++i) {
+		if (scan.find(-1) == scan.end()) {
+			cout << "We cheated cache scan test." << endl;
+			break;
+		}
+		scan[i] = i;
+	}
+}
+
+template<class Hashmap>
+void string_stuff(vector<int> &v, string s) {
+	constexpr int test = 1024 * 1024;
+	clock_t startTime;
+	double secondsPassed;
+	vector<string> keys(test / 2);
+	for (int i = 0; i < test / 2; ++i)
+		keys[i] = "a fairly long string key prefix #" + to_string(v[i]);
+	Hashmap basic;
+
+	startTime = clock();
+	for (int i = 0; i < test / 2; ++i)
+		basic[keys[i]] = i;
+	secondsPassed = double(clock() - startTime) / double(CLOCKS_PER_SEC);
+	cout << s << " String Key Insert Time: " << secondsPassed << " seconds." << endl;
+
+	for (int i = 0; i < test / 2; ++i) {
+		if (basic.at(keys[i]) != i)
+			cout << "We cheated string key test." << endl;
+	}
+	for (int i = 0; i < test / 2; ++i)
+		basic.erase(keys[i]);
+	if (!basic.empty())
+		cout << "We cheated string key erase test." << endl;
+}
+
 int main() {
 	const int test = 1024 * 1024;
 	unordered_map<int, int> original(test);
@@ -122,6 +362,7 @@ int main() {
 	quad_hashmap<int, int> quad(test);
 	rh_hashmap<int, int> rh(test);
 	cc_hashmap<int, int> cc(test);
+	cc_hashmap<int, int, hash_function<int>, derived_alt_hash> cc1(test);
 
 	vector<int> v(4 * 1024 * 1024);
 	for (int i = 0; i < 4 * 1024 * 1024; ++i)
@@ -134,6 +375,20 @@ int main() {
 	time_stuff<quad_hashmap<int, int>>(v, quad, "Quadratic");
 	time_stuff<rh_hashmap<int, int>>(v, rh, "Robin Hood");
 	time_stuff<cc_hashmap<int, int>>(v, cc, "Cuckoo");
+	time_stuff<cc_hashmap<int, int, hash_function<int>, derived_alt_hash>>(v, cc1, "Cuckoo (one hash)");
+	default_stuff<cc_hashmap<int, int>>(v, cc);
+	default_stuff<cc_hashmap<int, int, hash_function<int>, derived_alt_hash>>(v, cc1);
+	string_stuff<cc_hashmap<string, int, string_hash, string_alt_hash>>(v, "Cuckoo");
+	string_stuff<cc_hashmap<string, int, string_hash, derived_alt_hash>>(v, "Cuckoo (one hash)");
+
+	freeze_stuff<lin_hashmap<int, int>>(v, lin, "Linear");
+	freeze_stuff<rh_hashmap<int, int>>(v, rh, "Robin Hood");
+	freeze_collision_stuff(v);
+	set_stuff(v, test, "Robin Hood (equal capacity)");
+	set_stuff(v, test / 4, "Robin Hood (unequal capacity)");
+	aggregate_stuff(v, 4 * test, test / 16, "Linear (64K groups)");
+	aggregate_stuff(v, 32 * test, 4 * test, "Linear (4M groups)");
+	cache_stuff(v);
 
 	return 0;
 }
\ No newline at end of file
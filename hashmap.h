@@ -1,9 +1,15 @@
 #ifndef KIRBY_HASHMAP_H
 #define KIRBY_HASHMAP_H
 
+#include <algorithm>
 #include <tuple>
+#include <type_traits>
 #include <vector>
 #include <cinttypes>
+#include <stdexcept>
+#if defined(_MSC_VER)
+#include <xmmintrin.h>
+#endif
 
 /* Copyright 2017 Peter Kirby
 
@@ -26,6 +32,14 @@ FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
 IN THE SOFTWARE. */
 
 namespace kirby {
+	inline void prefetch(const void* ptr) {
+#if defined(__GNUC__)
+		__builtin_prefetch(ptr);
+#elif defined(_MSC_VER)
+		_mm_prefetch(static_cast<const char*>(ptr), _MM_HINT_T0);
+#endif
+	}
+
 	template <class Key>
 	struct hash_function;
 
@@ -59,6 +73,29 @@ namespace kirby {
 		}
 	};
 
+	// Derives the cuckoo alternate hash from the primary hash instead of the key,
+	// so evictions and rehashes of a cc_hashmap never hash a key a second time.
+	struct derived_alt_hash {
+		std::size_t operator()(std::size_t h) const {
+			uint32_t h2 = uint32_t(h); // lowbias32
+			h2 ^= h2 >> 16;
+			h2 *= 0x7feb352d;
+			h2 ^= h2 >> 15;
+			h2 *= 0x846ca68b;
+			h2 ^= h2 >> 16;
+			return h2;
+		}
+	};
+
+	template <class AltHash>
+	struct is_derived_alt_hash : std::false_type {};
+
+	template <>
+	struct is_derived_alt_hash<derived_alt_hash> : std::true_type {};
+
+	template <class Key, class T, class Hash>
+	class frozen_hashmap;
+
 	template <typename Derived, class Key, class T, class Hash = hash_function<Key> >
 	class base_hashmap
 	{
@@ -160,6 +197,10 @@ namespace kirby {
 			return is_found;
 		}
 
+		frozen_hashmap<Key, T, Hash> freeze() const {
+			return frozen_hashmap<Key, T, Hash>(*this, _m_hash);
+		}
+
 	private:
 		iterator _begin_it() const {
 			iterator ans(_start);
@@ -266,6 +307,13 @@ namespace kirby {
 			_init();
 		}
 
+		// exactly n buckets, n a power of two, skipping _next_size_up's growth steps
+		struct _exact_size {};
+		base_hashmap(_exact_size, size_type n, const Hash& hf)
+			: _table(n + 1, { _empty, internal_type() }), _m_hash(hf) {
+			_init();
+		}
+
 		size_type _calc_hash(const Key& k) const {
 			return _m_hash(k) & _max_hash;
 		}
@@ -386,6 +434,40 @@ namespace kirby {
 		void d_remove(bucket* ptr) {
 			static_cast<Derived*>(this)->dd_remove(ptr);
 		}
+
+		// Aggregation: folds values[i] into the entry for keys[i] with
+		// value = op(value, values[i]), or inserts values[i] for a new key. Keys
+		// are hashed and their home buckets prefetched a batch at a time.
+		template<class Op>
+		void upsert_combine(const Key* keys, const T* values, size_type n, Op op) {
+			size_type hashes[_batch_size];
+			for (size_type i = 0; i < n; i += _batch_size) {
+				const size_type m = n - i < _batch_size ? n - i : _batch_size;
+				const size_type mask = this->_bit_mask();
+				const bucket* const start = this->_start_ptr();
+				for (size_type j = 0; j < m; ++j) {
+					hashes[j] = this->_calc_hash(keys[i + j]);
+					prefetch(start + (hashes[j] & mask));
+				}
+				for (size_type j = 0; j < m; ++j) {
+					_upsert(keys[i + j], values[i + j], hashes[j], op);
+				}
+			}
+		}
+
+	private:
+		template<class Op>
+		void _upsert(const Key& k, const T& v, const size_type h, Op& op) {
+			bool is_not_found = true;
+			bucket* ptr = this->find_while_trying(k, is_not_found, h);
+			if (is_not_found) {
+				ptr->kv.second = v;
+			} else {
+				ptr->kv.second = op(ptr->kv.second, v);
+			}
+		}
+
+		static constexpr size_type _batch_size = 16;
 	};
 
 	template <class Key, class T, class Hash = hash_function<Key> >
@@ -400,15 +482,19 @@ namespace kirby {
 		explicit lin_hashmap(size_type n, const Hash& hf = Hash()) : Parent::probing_hashmap(n, hf) {}
 
 		void dd_remove(bucket* ptr) {
-			constexpr size_type empty = this->_empty;
-			const size_type mask = this->_bit_mask();
-			bucket* const start = this->_start_ptr();
+			ptr = shift_buckets_back(ptr, this->_start_ptr(), this->_bit_mask(), this->_empty);
+			this->_remove_for_empty(ptr);
+		}
+
+		// Shared with clock_cache, whose buckets are a different type.
+		template<class Bucket>
+		static Bucket* shift_buckets_back(Bucket* ptr, Bucket* const start, const size_type mask, const size_type empty) {
 			size_type i = ptr - start;
 			size_type j = i;
 			do {
 				++j;
 				j &= mask;
-				bucket* j_ptr = start + j;
+				Bucket* j_ptr = start + j;
 				if (j_ptr->h == empty) {
 					break;
 				}
@@ -420,7 +506,7 @@ namespace kirby {
 					i = j;
 				}
 			} while (true);
-			this->_remove_for_empty(ptr);
+			return ptr;
 		}
 
 		static size_type probe(size_type iteration, size_type hash) {
@@ -526,14 +612,68 @@ namespace kirby {
 			this->_remove_for_empty(ptr);
 		}
 
+		// Set operations. Entries are stored in home bucket order, so walking other
+		// in that order makes the probes into this map advance through memory too;
+		// with equal capacities both tables are read front to back.
+		void merge_from(const rh_hashmap& other) {
+			if (&other == this) {
+				return;
+			}
+			for (auto&& kv : other) {
+				this->insert(kv);
+			}
+		}
+
+		void intersect(const rh_hashmap& other) {
+			if (&other == this) {
+				return;
+			}
+			_filter(other, true);
+		}
+
+		void difference(const rh_hashmap& other) {
+			if (&other == this) {
+				this->clear();
+				return;
+			}
+			_filter(other, false);
+		}
+
+	private:
+		// Removes the entries whose presence in other differs from keep_found,
+		// compacting survivors back toward their home buckets as it goes.
+		void _filter(const rh_hashmap& other, const bool keep_found) {
+			constexpr size_type empty = this->_empty;
+			const size_type mask = this->_bit_mask();
+			bucket* const start = this->_start_ptr();
+			bucket* const end = this->_end_ptr();
+			bucket* w = start;
+			for (bucket* ptr = start; ptr != end; ++ptr) {
+				if (ptr->h == empty) {
+					continue;
+				}
+				if ((other.count(ptr->kv.first) != 0) != keep_found) {
+					this->_remove_for_empty(ptr);
+					continue;
+				}
+				bucket* pos = std::max(start + (ptr->h & mask), w);
+				if (pos != ptr) {
+					*pos = std::move(*ptr);
+					*ptr = { empty, internal_type() };
+				}
+				w = pos + 1;
+			}
+		}
+
+	public:
 		static constexpr size_type overflow_area_size = 128;
 	};
 
 	template <class Key, class T, class Hash = hash_function<Key>, class AltHash = alt_hash_function<Key> >
-	class cc_hashmap : public base_hashmap<cc_hashmap<Key, T, Hash>, Key, T, Hash >
+	class cc_hashmap : public base_hashmap<cc_hashmap<Key, T, Hash, AltHash>, Key, T, Hash >
 	{
 	public:
-		typedef typename kirby::base_hashmap<cc_hashmap<Key, T, Hash>, Key, T, Hash> Base;
+		typedef typename kirby::base_hashmap<cc_hashmap<Key, T, Hash, AltHash>, Key, T, Hash> Base;
 		typedef typename Base::size_type size_type;
 		typedef typename Base::value_type value_type;
 		typedef typename Base::internal_type internal_type;
@@ -545,7 +685,7 @@ namespace kirby {
 			: Base::base_hashmap(n, hf), m_alt_hash(ahf) {}
 
 		size_type calc_alt_hash(const Key& k) const {
-			return m_alt_hash(k) & this->_max_hash;
+			return _calc_alt_hash(k, this->_calc_hash(k));
 		}
 
 		bucket* d_find_without_inserting(const Key& k) const {
@@ -555,9 +695,9 @@ namespace kirby {
 			if (ptr->h == h && ptr->kv.first == k) {
 				return const_cast<bucket*>(ptr);
 			}
-			const size_type ah = this->calc_alt_hash(k);
+			const size_type ah = this->_calc_alt_hash(k, h);
 			const bucket* aptr = this->_half_start_ptr() + (ah & half_mask);
-			if (aptr->h == ah && aptr->kv.first == k) {
+			if (aptr->h == h && aptr->kv.first == k) {
 				return const_cast<bucket*>(aptr);
 			}
 			return const_cast<bucket*>(this->_end_ptr());
@@ -566,61 +706,58 @@ namespace kirby {
 		template<class FwdKey>
 		bucket* cuckoo_insert(bucket* first_ptr, FwdKey&& k, size_type first_h) {
 			constexpr size_type empty = this->_empty;
-			bucket* kick_list[max_search] = { nullptr };
-			size_type h, half_mask = this->_half_bit_mask();
+			bucket* kick_list[max_search];
+			const size_type half_mask = this->_half_bit_mask();
 			bucket* const start = this->_start_ptr();
 			bucket* const half_start = this->_half_start_ptr();
-			bucket* ptr = first_ptr;
+			bucket carry = std::move(*first_ptr);
+			bucket* ptr;
 			int depth = 0;
-			kick_list[depth++] = ptr;
 			do {
-				h = calc_alt_hash(ptr->kv.first);
-				ptr = half_start + (h & half_mask);
-				kick_list[depth++] = ptr;
-				if (ptr->h == empty) {
-					break;
+				// even steps evict from the first half, odd steps from the second
+				if (depth & 1) {
+					ptr = start + (carry.h & half_mask);
+				} else {
+					ptr = half_start + (_calc_alt_hash(carry.kv.first, carry.h) & half_mask);
 				}
-				ptr->h = h;
-				h = this->_calc_hash(ptr->kv.first);
-				ptr = start + (h & half_mask);
-				kick_list[depth++] = ptr;
-				if (ptr->h == empty) {
+				if (ptr == first_ptr) {
 					break;
 				}
-				ptr->h = h;
-				if (depth >= max_search - 1) {
-					return this->_insert_while_full(this->_end_ptr(), std::forward<FwdKey>(k), first_h);
+				std::swap(carry, *ptr);
+				kick_list[depth++] = ptr;
+				if (carry.h == empty) {
+					first_ptr->kv.second = T();
+					return this->_insert(first_ptr, std::forward<FwdKey>(k), first_h);
 				}
-			} while (true);
-			ptr->h = h;
-			for (int i = depth - 1; i; --i) {
-				kick_list[i]->kv = std::move(kick_list[i - 1]->kv);
+			} while (depth < max_search);
+			while (depth) {
+				std::swap(carry, *kick_list[--depth]);
 			}
-			return this->_insert(first_ptr, std::forward<FwdKey>(k), first_h);
+			*first_ptr = std::move(carry);
+			return this->_insert_while_full(this->_end_ptr(), std::forward<FwdKey>(k), first_h);
 		}
 
 		template<class FwdKey>
-		bucket* d_find_while_trying(FwdKey&& k, bool &is_not_found, const size_type unused_h) {
+		bucket* d_find_while_trying(FwdKey&& k, bool &is_not_found, const size_type h) {
 			constexpr size_type empty = this->_empty;
 			const size_type half_mask = this->_half_bit_mask();
-			const size_type h = this->_calc_hash(k);
 			bucket* ptr = this->_start_ptr() + (h & half_mask);
-			if (ptr->h == empty) {
-				return this->_insert(ptr, std::forward<FwdKey>(k), h);
-			}
 			if (ptr->h == h && ptr->kv.first == k) {
 				is_not_found = false;
 				return ptr;
 			}
-			const size_type ah = this->calc_alt_hash(k);
+			const size_type ah = this->_calc_alt_hash(k, h);
 			bucket* aptr = this->_half_start_ptr() + (ah & half_mask);
-			if (aptr->h == empty) {
-				return this->_insert(aptr, std::forward<FwdKey>(k), ah);
-			}
-			if (aptr->h == ah && aptr->kv.first == k) {
+			if (aptr->h == h && aptr->kv.first == k) {
 				is_not_found = false;
 				return aptr;
 			}
+			if (ptr->h == empty) {
+				return this->_insert(ptr, std::forward<FwdKey>(k), h);
+			}
+			if (aptr->h == empty) {
+				return this->_insert(aptr, std::forward<FwdKey>(k), h);
+			}
 			return cuckoo_insert(ptr, std::forward<FwdKey>(k), h);
 		}
 
@@ -629,8 +766,422 @@ namespace kirby {
 		}
 
 	private:
+		// Buckets in both halves store the primary hash, so only the alternate
+		// position ever needs deriving, and with derived_alt_hash never from the key.
+		size_type _calc_alt_hash(const Key& k, size_type h) const {
+			return _alt_hash(k, h, is_derived_alt_hash<AltHash>()) & this->_max_hash;
+		}
+
+		size_type _alt_hash(const Key& k, size_type, std::false_type) const {
+			return m_alt_hash(k);
+		}
+
+		size_type _alt_hash(const Key&, size_type h, std::true_type) const {
+			return m_alt_hash(h);
+		}
+
 		static constexpr int max_search = 128;
 		AltHash m_alt_hash;
 	};
+
+	// Fixed-capacity cache over a linear probing table that never rehashes. Once
+	// full, each insertion first evicts an entry chosen by CLOCK: the hand sweeps
+	// the table, clearing reference bits, and evicts the first entry without one.
+	// The reference bit is bit 30 of the stored hash, so a hit costs one find;
+	// only non-const lookups and operator[] count as uses.
+	template <class Key, class T, class Hash = hash_function<Key> >
+	class clock_cache : public base_hashmap<clock_cache<Key, T, Hash>, Key, T, Hash>
+	{
+	public:
+		typedef typename kirby::base_hashmap<clock_cache<Key, T, Hash>, Key, T, Hash> Base;
+		typedef typename Base::size_type size_type;
+		typedef typename Base::value_type value_type;
+		typedef typename Base::internal_type internal_type;
+		typedef typename Base::itb_type itb_type;
+		typedef struct Base::bucket bucket;
+		typedef class Base::iterator iterator;
+		typedef class Base::const_iterator const_iterator;
+		clock_cache() : clock_cache(Base::_initial_default_size) {}
+		// The table is the smallest power of two holding twice the capacity, which
+		// keeps the load factor under 0.51, so _rehash never runs.
+		explicit clock_cache(size_type n, const Hash& hf = Hash())
+			: Base::base_hashmap(typename Base::_exact_size(), _bucket_count(n), hf), _capacity(n) {}
+
+		size_type capacity() const noexcept { return _capacity; }
+		iterator find(const Key& k) { return iterator(_touch(this->find_without_inserting(k))); }
+		const_iterator find(const Key& k) const { return Base::find(k); }
+
+		T& at(const Key& k) {
+			bucket* ptr = _touch(this->find_without_inserting(k));
+			if (ptr != this->_end_ptr())
+				return ptr->kv.second;
+			throw std::out_of_range("invalid hash map<K, T> key");
+		}
+
+		const T& at(const Key& k) const { return Base::at(k); }
+
+		bucket* d_find_without_inserting(const Key& k) const {
+			constexpr size_type empty = this->_empty;
+			const size_type mask = this->_bit_mask();
+			const size_type h = this->_calc_hash(k) & _cache_hash;
+			const bucket* const start = this->_start_ptr();
+			size_type index = h;
+			bucket* ptr;
+			do {
+				index &= mask;
+				ptr = const_cast<bucket*>(start + index);
+				if ((ptr->h & _cache_hash) == h && ptr->kv.first == k) {
+					return ptr;
+				}
+				++index;
+			} while (ptr->h != empty);
+			return const_cast<bucket*>(this->_end_ptr());
+		}
+
+		template<class FwdKey>
+		bucket* d_find_while_trying(FwdKey&& k, bool &is_not_found, size_type h) {
+			h &= _cache_hash;
+			bucket* ptr = _probe(k, h);
+			if (ptr->h != this->_empty) {
+				_touch(ptr);
+				is_not_found = false;
+				return ptr;
+			}
+			if (this->size() >= _capacity) {
+				evict();
+				ptr = _probe(k, h);
+			}
+			return this->_insert(ptr, std::forward<FwdKey>(k), h | _referenced);
+		}
+
+		void d_remove(bucket* ptr) {
+			ptr = lin_hashmap<Key, T, Hash>::shift_buckets_back(ptr, this->_start_ptr(), this->_bit_mask(), this->_empty);
+			this->_remove_for_empty(ptr);
+		}
+
+		// Evicts one entry by CLOCK; the hand clears at most one bit per access
+		// since it last passed, so eviction is amortized O(1).
+		void evict() {
+			constexpr size_type empty = this->_empty;
+			const size_type mask = this->_bit_mask();
+			bucket* const start = this->_start_ptr();
+			if (this->empty())
+				return;
+			do {
+				bucket* ptr = start + _hand;
+				if (ptr->h != empty) {
+					if (!(ptr->h & _referenced)) {
+						// the backward shift refills this bucket, so the hand stays
+						d_remove(ptr);
+						return;
+					}
+					ptr->h &= ~_referenced;
+				}
+				_hand = (_hand + 1) & mask;
+			} while (true);
+		}
+
+	private:
+		// validate the capacity before anything is allocated
+		static size_type _bucket_count(size_type n) {
+			if (n == 0 || n > _max_cache_capacity)
+				throw std::length_error("clock cache<K, T> capacity out of range");
+			size_type buckets = Base::_initial_default_size;
+			while (buckets < 2 * n) {
+				buckets <<= 1;
+			}
+			return buckets;
+		}
+
+		// set the reference bit, without dirtying the line when already set
+		bucket* _touch(bucket* ptr) {
+			if (ptr != this->_end_ptr() && !(ptr->h & _referenced)) {
+				ptr->h |= _referenced;
+			}
+			return ptr;
+		}
+
+		bucket* _probe(const Key& k, const size_type h) {
+			constexpr size_type empty = this->_empty;
+			const size_type mask = this->_bit_mask();
+			bucket* const start = this->_start_ptr();
+			size_type index = h;
+			bucket* ptr;
+			do {
+				index &= mask;
+				ptr = start + index;
+				if (ptr->h == empty || ((ptr->h & _cache_hash) == h && ptr->kv.first == k)) {
+					return ptr;
+				}
+				++index;
+			} while (true);
+		}
+
+		size_type _capacity;
+		size_type _hand = 0;
+
+		static constexpr size_type _referenced = size_type(1) << 30;
+		static constexpr size_type _cache_hash = _referenced - 1;
+		static constexpr size_type _max_cache_capacity = _referenced >> 2;
+	};
+
+	// Read-only map over a dense key/value array, addressed by a minimal perfect
+	// hash (PTHash style: keys are grouped into buckets, and each bucket gets a
+	// pilot that scatters its keys into free slots). A lookup is one probe and
+	// one key compare. Keys that share a Hash value cannot be told apart by any
+	// perfect hash, so all but one of each such group sit in runs after the
+	// perfect hash slots, found through a small index sorted by hash that is only
+	// searched when the probed key does not match. Build from any finished map,
+	// or with base_hashmap::freeze().
+	template <class Key, class T, class Hash = hash_function<Key> >
+	class frozen_hashmap
+	{
+	public:
+		typedef uint32_t size_type;
+		typedef std::pair<const Key, T> value_type;
+		typedef std::pair<Key, T> internal_type;
+		typedef const value_type* const_iterator;
+		typedef const_iterator iterator;
+
+		frozen_hashmap() { _build(std::vector<const value_type*>()); }
+
+		template <class Map>
+		explicit frozen_hashmap(const Map& m, const Hash& hf = Hash()) : _m_hash(hf) {
+			std::vector<const value_type*> src;
+			src.reserve(m.size());
+			for (auto&& kv : m) {
+				src.push_back(reinterpret_cast<const value_type*>(&kv));
+			}
+			_build(src);
+		}
+
+		bool empty() const noexcept { return _table.empty(); }
+		size_type size() const noexcept { return size_type(_table.size()); }
+		size_type max_size() const noexcept { return size(); }
+		const_iterator begin() const noexcept { return reinterpret_cast<const value_type*>(_table.data()); }
+		const_iterator cbegin() const noexcept { return begin(); }
+		const_iterator end() const noexcept { return begin() + _table.size(); }
+		const_iterator cend() const noexcept { return end(); }
+		size_type count(const Key& k) const { return find(k) != end(); }
+
+		const_iterator find(const Key& k) const {
+			if (_table.empty())
+				return end();
+			const uint64_t h = uint64_t(_m_hash(k));
+			const uint64_t kh = _seeded(h);
+			const internal_type* ptr = &_table[_slot_of(kh, _pilots[_bucket_of(kh)])];
+			if (ptr->first == k)
+				return reinterpret_cast<const value_type*>(ptr);
+			if (!_overflow.empty())
+				return _find_overflow(k, h);
+			return end();
+		}
+
+		const T& at(const Key& k) const {
+			const_iterator it = find(k);
+			if (it != end())
+				return it->second;
+			throw std::out_of_range("invalid hash map<K, T> key");
+		}
+
+	private:
+		struct overflow_run {
+			uint64_t hash;
+			size_type first;
+			size_type last;
+		};
+
+		static uint64_t _mix(uint64_t x) { // MurmurHash3 fmix64
+			x ^= x >> 33;
+			x *= 0xff51afd7ed558ccdULL;
+			x ^= x >> 33;
+			x *= 0xc4ceb9fe1a85ec53ULL;
+			x ^= x >> 33;
+			return x;
+		}
+
+		// multiply-shift range reduction, avoids a division per lookup
+		static size_type _reduce(uint32_t x, size_type n) {
+			return size_type((uint64_t(x) * n) >> 32);
+		}
+
+		uint64_t _seeded(uint64_t h) const {
+			return _mix(h ^ _seed);
+		}
+
+		size_type _bucket_of(uint64_t kh) const {
+			return _reduce(uint32_t(kh >> 32), size_type(_pilots.size()));
+		}
+
+		size_type _slot_of(uint64_t kh, uint32_t pilot) const {
+			if (pilot & _direct)
+				return pilot & ~_direct;
+			return _reduce(uint32_t(kh ^ _mix(uint64_t(pilot) + _seed)), _slots);
+		}
+
+		const_iterator _find_overflow(const Key& k, const uint64_t h) const {
+			auto run = std::lower_bound(_overflow.begin(), _overflow.end(), h,
+				[](const overflow_run& r, uint64_t x) { return r.hash < x; });
+			if (run == _overflow.end() || run->hash != h)
+				return end();
+			for (size_type i = run->first; i != run->last; ++i) {
+				if (_table[i].first == k)
+					return begin() + i;
+			}
+			return end();
+		}
+
+		void _build(const std::vector<const value_type*>& src) {
+			const size_type n = size_type(src.size());
+			_table.assign(n, internal_type());
+			_overflow.clear();
+			std::vector<uint64_t> hashes(n);
+			for (size_type i = 0; i < n; ++i)
+				hashes[i] = uint64_t(_m_hash(src[i]->first));
+			// equal hashes share a bucket under any seed, so duplicates are found
+			// by sorting each (usually tiny) bucket rather than the whole input
+			const size_type buckets = n / _keys_per_bucket + 1;
+			std::vector<size_type> first(buckets + 1, 0);
+			std::vector<size_type> order(n);
+			for (size_type i = 0; i < n; ++i)
+				++first[_reduce(uint32_t(_mix(hashes[i]) >> 32), buckets) + 1];
+			for (size_type b = 0; b < buckets; ++b)
+				first[b + 1] += first[b];
+			{
+				std::vector<size_type> fill(first.begin(), first.end() - 1);
+				for (size_type i = 0; i < n; ++i)
+					order[fill[_reduce(uint32_t(_mix(hashes[i]) >> 32), buckets)]++] = i;
+			}
+			// one key per hash value goes through the perfect hash, the rest
+			// are appended after it in runs of equal hash
+			std::vector<bool> is_extra(n, false);
+			std::vector<const value_type*> extra;
+			for (size_type b = 0; b < buckets; ++b) {
+				const size_type end_of_bucket = first[b + 1];
+				if (end_of_bucket - first[b] < 2)
+					continue;
+				std::sort(order.begin() + first[b], order.begin() + end_of_bucket,
+					[&hashes](size_type x, size_type y) { return hashes[x] < hashes[y]; });
+				for (size_type i = first[b] + 1; i < end_of_bucket; ++i) {
+					const uint64_t h = hashes[order[i]];
+					if (h != hashes[order[i - 1]])
+						continue;
+					if (!is_extra[order[i - 1]]) {
+						overflow_run run = { h, size_type(extra.size()), 0 };
+						_overflow.push_back(run);
+					}
+					is_extra[order[i]] = true;
+					extra.push_back(src[order[i]]);
+					_overflow.back().last = size_type(extra.size());
+				}
+			}
+			std::vector<const value_type*> unique;
+			std::vector<uint64_t> unique_hashes;
+			unique.reserve(n - extra.size());
+			unique_hashes.reserve(n - extra.size());
+			for (size_type i = 0; i < n; ++i) {
+				if (!is_extra[i]) {
+					unique.push_back(src[i]);
+					unique_hashes.push_back(hashes[i]);
+				}
+			}
+			std::sort(_overflow.begin(), _overflow.end(),
+				[](const overflow_run& x, const overflow_run& y) { return x.hash < y.hash; });
+			_slots = size_type(unique.size());
+			for (auto&& run : _overflow) {
+				run.first += _slots;
+				run.last += _slots;
+			}
+			for (size_type i = 0; i < size_type(extra.size()); ++i)
+				_table[_slots + i] = *extra[i];
+			_pilots.assign(_slots / _keys_per_bucket + 1, 0);
+			if (_slots == 0)
+				return;
+			for (int attempt = 0; attempt < _max_seeds; ++attempt) {
+				_seed = _mix(uint64_t(attempt) + 1);
+				if (_try_build(unique, unique_hashes))
+					return;
+			}
+			throw std::length_error("frozen hash map<K, T> found no perfect hash");
+		}
+
+		bool _try_build(const std::vector<const value_type*>& src, const std::vector<uint64_t>& raw) {
+			const size_type n = _slots;
+			const size_type buckets = size_type(_pilots.size());
+			std::vector<uint64_t> hashes(n);
+			std::vector<size_type> first(buckets + 1, 0);
+			std::vector<size_type> order(n);
+			for (size_type i = 0; i < n; ++i) {
+				hashes[i] = _seeded(raw[i]);
+				++first[_bucket_of(hashes[i]) + 1];
+			}
+			for (size_type b = 0; b < buckets; ++b)
+				first[b + 1] += first[b];
+			{
+				std::vector<size_type> fill(first.begin(), first.end() - 1);
+				for (size_type i = 0; i < n; ++i)
+					order[fill[_bucket_of(hashes[i])]++] = i;
+			}
+			// place the largest buckets first, while the table is still sparse
+			size_type largest = 0;
+			for (size_type b = 0; b < buckets; ++b)
+				largest = std::max(largest, first[b + 1] - first[b]);
+			std::vector<size_type> by_size;
+			by_size.reserve(buckets);
+			for (size_type len = largest; len; --len) {
+				for (size_type b = 0; b < buckets; ++b) {
+					if (first[b + 1] - first[b] == len)
+						by_size.push_back(b);
+				}
+			}
+			std::vector<bool> taken(n, false);
+			std::vector<size_type> slots(largest);
+			size_type next_free = 0;
+			for (size_type b : by_size) {
+				const size_type len = first[b + 1] - first[b];
+				if (len == 1) { // the table is nearly full, so give singletons a slot directly
+					while (taken[next_free])
+						++next_free;
+					taken[next_free] = true;
+					_pilots[b] = _direct | next_free;
+					continue;
+				}
+				uint32_t pilot = 0;
+				for (;; ++pilot) {
+					if (pilot >= _max_pilot)
+						return false;
+					size_type placed = 0;
+					for (; placed < len; ++placed) {
+						size_type slot = _slot_of(hashes[order[first[b] + placed]], pilot);
+						if (taken[slot])
+							break;
+						taken[slot] = true;
+						slots[placed] = slot;
+					}
+					if (placed == len)
+						break;
+					while (placed)
+						taken[slots[--placed]] = false;
+				}
+				_pilots[b] = pilot;
+			}
+			for (size_type i = 0; i < n; ++i)
+				_table[_slot_of(hashes[i], _pilots[_bucket_of(hashes[i])])] = *src[i];
+			return true;
+		}
+
+		std::vector<internal_type> _table;
+		std::vector<uint32_t> _pilots;
+		std::vector<overflow_run> _overflow;
+		size_type _slots = 0;
+		uint64_t _seed = 0;
+		Hash _m_hash;
+
+		static constexpr size_type _keys_per_bucket = 2;
+		static constexpr int _max_seeds = 16;
+		// builds of millions of keys need pilots below a thousand
+		static constexpr uint32_t _max_pilot = uint32_t(1) << 16;
+		static constexpr uint32_t _direct = uint32_t(1) << 31;
+	};
 }
 #endif
\ No newline at end of file